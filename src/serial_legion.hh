@@ -2,7 +2,10 @@
 #define SERIAL_LEGION_HH_
 
 #include <cstddef>
+#include <map>
+#include <memory>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 enum legion_privilege_mode_t {
@@ -23,11 +26,16 @@ typedef unsigned long FieldID;
 typedef unsigned int TaskID;
 typedef unsigned int VariantID;
 typedef size_t FieldSpaceID;
+typedef size_t IndexPartitionID;
 typedef size_t RegionID;
 typedef long long int coord_t;
 typedef ::legion_privilege_mode_t PrivilegeMode;
 typedef ::legion_coherence_property_t CoherenceProperty;
 
+namespace impl {
+    class SparsityMapImpl;
+}  // namespace impl
+
 /* Geometric types. */
 
 template <unsigned int DIM, typename T = int>
@@ -51,6 +59,7 @@ public:
     DomainPoint(const Point<DIM>& rhs);
     DomainPoint(coord_t coord);
     bool operator==(const DomainPoint& other) const;
+    bool operator<(const DomainPoint& other) const;
     coord_t& operator[](unsigned int ix);
     const coord_t& operator[](unsigned int ix) const;
 };
@@ -62,15 +71,54 @@ public:
 
     Rect(Point<DIM, T> lo_, Point<DIM, T> hi_);
 };
+// Points are stored in column-major order (dimension 0 fastest), whether
+// the domain is dense or sparse.
 class Domain {
 public:
+    class DomainPointIterator;
+
     DomainPoint lo, hi;
+    // Valid points of a sparse domain, null if every point in the bounding
+    // box is valid.
+    std::shared_ptr<const impl::SparsityMapImpl> sparsity;
 
     Domain() = default;
     template <unsigned int DIM, typename T = int>
     Domain(const Rect<DIM, T>& other);
     bool operator==(const Domain& other) const;
+    unsigned int get_dim() const;
+    bool dense() const;
+    bool contains(const DomainPoint& p) const;
     size_t size() const;
+    // Sets index to the storage position of p if it is a valid point.
+    template <typename P>
+    bool find(const P& p, size_t& index) const;
+    // Storage position of a valid point.
+    template <typename P>
+    size_t index_of(const P& p) const;
+    // Valid point at a storage position.
+    DomainPoint point_at(size_t index) const;
+};
+// Visits the valid points of a domain in storage order. Copies share the
+// domain, so copying an iterator only copies its current point.
+class Domain::DomainPointIterator {
+public:
+    std::shared_ptr<const Domain> dom;
+    DomainPoint p;
+    // Storage position of p and, for sparse domains, the run containing it.
+    size_t index, count, run;
+
+    DomainPointIterator(const Domain& d);
+    operator bool() const;
+    const DomainPoint& operator*() const;
+    bool step();
+
+    // Sets cur to the first valid point of d.
+    template <typename C>
+    static void first(const Domain& d, std::vector<C>& cur);
+    // Moves cur, in run, to the next valid point of d.
+    template <typename C>
+    static void advance(const Domain& d, size_t& run, std::vector<C>& cur);
 };
 
 template <unsigned int DIM, typename T = int>
@@ -84,6 +132,22 @@ public:
     Point<DIM, T> operator*(void) const;
     PointInRectIterator<DIM, T> operator++(int);
 };
+// Prefix increment does not allocate, postfix increment copies the point.
+// Points are always stored column-major, so row-major order is rejected.
+template <unsigned int DIM, typename T = int>
+class PointInDomainIterator {
+public:
+    std::shared_ptr<const Domain> dom;
+    Point<DIM, T> p;
+    // Storage position of p and, for sparse domains, the run containing it.
+    size_t index, count, run;
+
+    PointInDomainIterator(const Domain& d, bool column_major_order = true);
+    bool operator()(void) const;
+    const Point<DIM, T>& operator*(void) const;
+    PointInDomainIterator<DIM, T>& operator++(void);
+    PointInDomainIterator<DIM, T> operator++(int);
+};
 
 /* Memory structures. */
 
@@ -100,7 +164,15 @@ class IndexSpaceT : public IndexSpace {
 public:
     IndexSpaceT(const IndexSpace& rhs);
 };
-class IndexPartition {};
+class IndexPartition {
+public:
+    static const IndexPartition NO_PART;
+
+    IndexPartitionID id;
+
+    IndexPartition();
+    IndexPartition(IndexPartitionID _id);
+};
 
 class FieldSpace {
 public:
@@ -123,6 +195,7 @@ public:
 
     LogicalRegion(RegionID _id);
     bool operator==(const LogicalRegion& other) const;
+    IndexSpace get_index_space() const;
 };
 template <unsigned int DIM>
 class LogicalRegionT : public LogicalRegion {
@@ -132,8 +205,9 @@ public:
 class LogicalPartition {
 public:
     LogicalRegion region;
+    IndexPartition index_partition;
 
-    LogicalPartition(LogicalRegion _region);
+    LogicalPartition(LogicalRegion _region, IndexPartition _index_partition);
 };
 
 class RegionRequirement {
@@ -161,10 +235,38 @@ public:
 
     FieldAccessor(const PhysicalRegion& region, FieldID fid);
     FT& operator[](const Point<N>& p) const;
+    // Uses the iterator's storage position directly if it walks the index
+    // space the region's storage is laid out for.
+    template <typename T>
+    FT& operator[](const PointInDomainIterator<N, T>& it) const;
+
+private:
+    FT& at_index(RegionID root, size_t index) const;
 };
 
 namespace impl {
 
+    class SparsityMapImpl {
+    public:
+        unsigned int dim;
+        // Maximal runs of valid points along dimension 0, in column-major
+        // order. Each run is its first point followed by its last coordinate
+        // in dimension 0.
+        std::vector<coord_t> runs;
+        // Number of valid points before each run, followed by the total.
+        std::vector<size_t> offsets;
+
+        size_t num_runs() const;
+        const coord_t* run(size_t r) const;
+    };
+
+    class IndexPartitionImpl {
+    public:
+        std::map<DomainPoint, IndexSpace> subspaces;
+        // Subregions already created, keyed by parent region and color.
+        std::map<std::pair<RegionID, DomainPoint>, RegionID> subregions;
+    };
+
     class FieldSpaceImpl {
     public:
         std::unordered_map<FieldID, size_t> field_sizes;
@@ -174,8 +276,11 @@ namespace impl {
     public:
         IndexSpace index_space;
         FieldSpace field_space;
+        // Region that owns the storage, which is the region itself unless it
+        // was created by partitioning.
+        RegionID root;
 
-        LogicalRegionImpl(IndexSpace ispace, FieldSpace fspace);
+        LogicalRegionImpl(IndexSpace ispace, FieldSpace fspace, RegionID _root);
     };
 
     class PhysicalRegionImpl {
@@ -183,12 +288,23 @@ namespace impl {
         std::unordered_map<FieldID, void*> fields;
     };
 
+    void append_point(std::vector<coord_t>& runs, unsigned int dim,
+                      const DomainPoint& p);
+    void append_runs(std::vector<coord_t>& runs, unsigned int dim,
+                     const Domain& dom);
+    Domain make_sparse_domain(unsigned int dim, std::vector<coord_t> runs);
+    size_t field_size(LogicalRegion region, FieldID fid);
+    void* field_ptr(LogicalRegion region, FieldID fid, const DomainPoint& p);
+    DomainPoint read_point_field(LogicalRegion region, FieldID fid,
+                                 const DomainPoint& p);
+
 }  // namespace impl
 
 /* Runtime types and classes. */
 
 class Context {
 public:
+    inline static std::vector<impl::IndexPartitionImpl> index_partitions;
     inline static std::vector<impl::FieldSpaceImpl> field_spaces;
     inline static std::vector<impl::LogicalRegionImpl> logical_regions;
     inline static std::vector<impl::PhysicalRegionImpl> physical_regions;
@@ -198,12 +314,23 @@ class Future {
 public:
     void* res = nullptr;
 
-    Future(void* _res);
+    Future(void* _res = nullptr);
     void get_void_result() const;
     template <typename T>
     T get_result() const;
     bool is_ready() const;
 };
+// Futures are always ready, so a predicate is resolved as soon as it is made.
+class Predicate {
+public:
+    static const Predicate TRUE_PRED;
+    static const Predicate FALSE_PRED;
+
+    bool value;
+
+    Predicate();
+    explicit Predicate(bool _value);
+};
 
 class Processor {
 public:
@@ -236,8 +363,15 @@ public:
     TaskID _tid;
     TaskArgument _arg;
     std::vector<RegionRequirement> reqs;
-
-    TaskLauncher(TaskID tid, TaskArgument arg);
+    Predicate predicate;
+    // Result of the launch if the predicate is false. The future takes
+    // precedence over the argument if both are set. If neither is set, the
+    // result of an elided launch cannot be read.
+    Future predicate_false_future;
+    TaskArgument predicate_false_result;
+
+    TaskLauncher(TaskID tid, TaskArgument arg,
+                 Predicate pred = Predicate::TRUE_PRED);
     RegionRequirement& add_region_requirement(const RegionRequirement& req);
     void add_field(unsigned int idx, FieldID fid);
 };
@@ -256,6 +390,29 @@ public:
 
     InlineLauncher(const RegionRequirement& req);
 };
+class CopyLauncher {
+public:
+    std::vector<RegionRequirement> src_requirements;
+    std::vector<RegionRequirement> dst_requirements;
+    Predicate predicate;
+
+    CopyLauncher(Predicate pred = Predicate::TRUE_PRED);
+    unsigned int add_copy_requirements(const RegionRequirement& src,
+                                       const RegionRequirement& dst);
+    void add_src_field(unsigned int idx, FieldID fid);
+    void add_dst_field(unsigned int idx, FieldID fid);
+};
+class FillLauncher {
+public:
+    LogicalRegion handle;
+    TaskArgument argument;
+    std::vector<FieldID> fields;
+    Predicate predicate;
+
+    FillLauncher(LogicalRegion _handle, LogicalRegion parent, TaskArgument arg,
+                 Predicate pred = Predicate::TRUE_PRED);
+    void add_field(FieldID fid);
+};
 
 struct InputArgs {
     int argc;
@@ -275,9 +432,28 @@ public:
     static void set_top_level_task_id(TaskID top_id);
     static int start(int argc, char** argv);
     IndexSpace create_index_space(Context ctx, const Domain& bounds);
+    IndexSpace create_index_space(Context ctx,
+                                  const std::vector<DomainPoint>& points);
+    IndexSpace create_index_space(Context ctx,
+                                  const std::vector<Domain>& rects);
     void destroy_index_space(Context ctx, IndexSpace handle);
+    Domain get_index_space_domain(IndexSpace handle);
     IndexPartition create_equal_partition(Context ctx, IndexSpace parent,
                                           IndexSpace color_space);
+    IndexPartition create_partition_by_field(Context ctx, LogicalRegion handle,
+                                             LogicalRegion parent, FieldID fid,
+                                             IndexSpace color_space);
+    IndexPartition create_partition_by_image(Context ctx, IndexSpace handle,
+                                             LogicalPartition projection,
+                                             LogicalRegion parent, FieldID fid,
+                                             IndexSpace color_space);
+    IndexPartition create_partition_by_preimage(Context ctx,
+                                                IndexPartition projection,
+                                                LogicalRegion handle,
+                                                LogicalRegion parent,
+                                                FieldID fid,
+                                                IndexSpace color_space);
+    IndexSpace get_index_subspace(IndexPartition p, const DomainPoint& color);
     FieldSpace create_field_space(Context ctx);
     void destroy_field_space(Context ctx, FieldSpace handle);
     FieldAllocator create_field_allocator(Context ctx, FieldSpace handle);
@@ -291,6 +467,15 @@ public:
     LogicalRegion get_logical_subregion_by_color(LogicalPartition parent,
                                                  const DomainPoint& c);
     Future execute_task(Context ctx, const TaskLauncher& launcher);
+    void issue_copy_operation(Context ctx, const CopyLauncher& launcher);
+    void fill_fields(Context ctx, const FillLauncher& launcher);
+    Predicate create_predicate(Context ctx, const Future& f);
+    Predicate predicate_not(Context ctx, const Predicate& p);
+    Predicate predicate_and(Context ctx, const Predicate& p1,
+                            const Predicate& p2);
+    Predicate predicate_or(Context ctx, const Predicate& p1,
+                           const Predicate& p2);
+    Future get_predicate_future(Context ctx, const Predicate& p);
     template <typename T,
               T (*TASK_PTR)(const Task*, const std::vector<PhysicalRegion>&,
                             Context, Runtime*)>
@@ -7,8 +7,14 @@
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <numeric>
 #include <stdexcept>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "serial_legion.hh"
@@ -55,6 +61,9 @@ inline DomainPoint::DomainPoint(coord_t coord) { coords.push_back(coord); }
 inline bool DomainPoint::operator==(const DomainPoint& other) const {
     return coords == other.coords;
 }
+inline bool DomainPoint::operator<(const DomainPoint& other) const {
+    return coords < other.coords;
+}
 inline coord_t& DomainPoint::operator[](unsigned int ix) {
     return coords.at(ix);
 }
@@ -68,15 +77,174 @@ Rect<DIM, T>::Rect(Point<DIM, T> lo_, Point<DIM, T> hi_) : lo(lo_), hi(hi_) {}
 template <unsigned int DIM, typename T>
 Domain::Domain(const Rect<DIM, T>& other) : lo(other.lo), hi(other.hi) {}
 inline bool Domain::operator==(const Domain& other) const {
-    return lo == other.lo && hi == other.hi;
+    if (!(lo == other.lo && hi == other.hi)) {
+        return false;
+    }
+    if (sparsity == other.sparsity) {
+        return true;
+    }
+    return sparsity && other.sparsity && sparsity->dim == other.sparsity->dim &&
+           sparsity->runs == other.sparsity->runs;
+}
+inline unsigned int Domain::get_dim() const {
+    return dense() ? lo.coords.size() : sparsity->dim;
+}
+inline bool Domain::dense() const { return !sparsity; }
+inline bool Domain::contains(const DomainPoint& p) const {
+    size_t index;
+    return find(p, index);
 }
 inline size_t Domain::size() const {
+    if (!dense()) {
+        return sparsity->offsets.back();
+    }
     size_t size = 1;
     for (unsigned int i = 0; i < lo.coords.size(); i++) {
         size *= hi.coords.at(i) - lo.coords.at(i) + 1;
     }
     return size;
 }
+template <typename P>
+bool Domain::find(const P& p, size_t& index) const {
+    if (dense()) {
+        if (p.coords.size() != lo.coords.size()) {
+            return false;
+        }
+        index = 0;
+        size_t dim_prod = 1;
+        for (unsigned int dim = 0; dim < p.coords.size(); dim++) {
+            if (p.coords[dim] < lo.coords[dim] ||
+                hi.coords[dim] < p.coords[dim]) {
+                return false;
+            }
+            index += (p.coords[dim] - lo.coords[dim]) * dim_prod;
+            dim_prod *= hi.coords[dim] - lo.coords[dim] + 1;
+        }
+        return true;
+    }
+    const impl::SparsityMapImpl& map = *sparsity;
+    unsigned int dim = map.dim;
+    if (p.coords.size() != dim) {
+        return false;
+    }
+    // Find the last run that starts at or before p.
+    size_t first = 0, last = map.num_runs();
+    while (first < last) {
+        size_t mid = first + (last - first) / 2;
+        const coord_t* run = map.run(mid);
+        bool before = p.coords[0] < run[0];
+        for (unsigned int d = dim; d-- > 1;) {
+            if (p.coords[d] != run[d]) {
+                before = p.coords[d] < run[d];
+                break;
+            }
+        }
+        if (before) {
+            last = mid;
+        } else {
+            first = mid + 1;
+        }
+    }
+    if (first == 0) {
+        return false;
+    }
+    const coord_t* run = map.run(first - 1);
+    for (unsigned int d = 1; d < dim; d++) {
+        if (p.coords[d] != run[d]) {
+            return false;
+        }
+    }
+    if (run[dim] < p.coords[0]) {
+        return false;
+    }
+    index = map.offsets[first - 1] + (p.coords[0] - run[0]);
+    return true;
+}
+template <typename P>
+size_t Domain::index_of(const P& p) const {
+    size_t index;
+    if (!find(p, index)) {
+        throw std::out_of_range("point is not in domain");
+    }
+    return index;
+}
+inline DomainPoint Domain::point_at(size_t index) const {
+    if (index >= size()) {
+        throw std::out_of_range("index is out of domain");
+    }
+    DomainPoint p;
+    if (!dense()) {
+        const std::vector<size_t>& offsets = sparsity->offsets;
+        size_t r =
+            std::upper_bound(offsets.begin(), offsets.end(), index) -
+            offsets.begin() - 1;
+        const coord_t* run = sparsity->run(r);
+        p.coords.assign(run, run + sparsity->dim);
+        p.coords[0] += index - offsets[r];
+        return p;
+    }
+    for (unsigned int dim = 0; dim < lo.coords.size(); dim++) {
+        size_t extent = hi[dim] - lo[dim] + 1;
+        p.coords.push_back(lo[dim] + index % extent);
+        index /= extent;
+    }
+    return p;
+}
+
+inline Domain::DomainPointIterator::DomainPointIterator(const Domain& d)
+    : dom(std::make_shared<const Domain>(d)),
+      index(0),
+      count(d.size()),
+      run(0) {
+    if (count > 0) {
+        first(d, p.coords);
+    }
+}
+inline Domain::DomainPointIterator::operator bool() const {
+    return index < count;
+}
+inline const DomainPoint& Domain::DomainPointIterator::operator*() const {
+    return p;
+}
+inline bool Domain::DomainPointIterator::step() {
+    if (++index >= count) {
+        return false;
+    }
+    advance(*dom, run, p.coords);
+    return true;
+}
+template <typename C>
+void Domain::DomainPointIterator::first(const Domain& d,
+                                        std::vector<C>& cur) {
+    if (d.dense()) {
+        cur.assign(d.lo.coords.begin(), d.lo.coords.end());
+    } else {
+        const coord_t* run = d.sparsity->run(0);
+        cur.assign(run, run + d.sparsity->dim);
+    }
+}
+template <typename C>
+void Domain::DomainPointIterator::advance(const Domain& d, size_t& run,
+                                          std::vector<C>& cur) {
+    if (d.dense()) {
+        for (unsigned int i = 0; i < cur.size(); i++) {
+            if (cur[i] == d.hi.coords[i]) {
+                cur[i] = d.lo.coords[i];
+            } else {
+                cur[i]++;
+                break;
+            }
+        }
+        return;
+    }
+    unsigned int dim = d.sparsity->dim;
+    if (cur[0] < d.sparsity->run(run)[dim]) {
+        cur[0]++;
+    } else {
+        const coord_t* next = d.sparsity->run(++run);
+        std::copy(next, next + dim, cur.begin());
+    }
+}
 
 template <unsigned int DIM, typename T>
 PointInRectIterator<DIM, T>::PointInRectIterator(const Rect<DIM, T>& r,
@@ -115,6 +283,48 @@ PointInRectIterator<DIM, T> PointInRectIterator<DIM, T>::operator++(int) {
     return *this;
 }
 
+template <unsigned int DIM, typename T>
+PointInDomainIterator<DIM, T>::PointInDomainIterator(const Domain& d,
+                                                     bool column_major_order)
+    : dom(std::make_shared<const Domain>(d)),
+      p(0),
+      index(0),
+      count(d.size()),
+      run(0) {
+    if (!column_major_order) {
+        throw std::logic_error("only column-major iteration is supported");
+    }
+    if (count > 0 && d.get_dim() != DIM) {
+        throw std::logic_error("domain and iterator dimensions differ");
+    }
+    if (count > 0) {
+        Domain::DomainPointIterator::first(d, p.coords);
+    }
+}
+
+template <unsigned int DIM, typename T>
+bool PointInDomainIterator<DIM, T>::operator()(void) const {
+    return index < count;
+}
+template <unsigned int DIM, typename T>
+const Point<DIM, T>& PointInDomainIterator<DIM, T>::operator*(void) const {
+    return p;
+}
+template <unsigned int DIM, typename T>
+PointInDomainIterator<DIM, T>& PointInDomainIterator<DIM, T>::operator++(
+    void) {
+    if (++index < count) {
+        Domain::DomainPointIterator::advance(*dom, run, p.coords);
+    }
+    return *this;
+}
+template <unsigned int DIM, typename T>
+PointInDomainIterator<DIM, T> PointInDomainIterator<DIM, T>::operator++(int) {
+    PointInDomainIterator<DIM, T> prev = *this;
+    ++*this;
+    return prev;
+}
+
 /* Memory structures. */
 
 inline IndexSpace::IndexSpace(Domain _dom) : dom(_dom) {}
@@ -124,6 +334,10 @@ inline bool IndexSpace::operator==(const IndexSpace& other) const {
 inline size_t IndexSpace::size() const { return dom.size(); }
 template <unsigned int DIM>
 IndexSpaceT<DIM>::IndexSpaceT(const IndexSpace& rhs) : IndexSpace(rhs.dom) {}
+inline IndexPartition::IndexPartition()
+    : id(std::numeric_limits<IndexPartitionID>::max()) {}
+inline IndexPartition::IndexPartition(IndexPartitionID _id) : id(_id) {}
+inline const IndexPartition IndexPartition::NO_PART;
 
 inline FieldSpace::FieldSpace(FieldSpaceID fsid) : id(fsid) {}
 inline bool FieldSpace::operator==(const FieldSpace& other) const {
@@ -142,11 +356,15 @@ inline LogicalRegion::LogicalRegion(RegionID _id) : id(_id) {}
 inline bool LogicalRegion::operator==(const LogicalRegion& other) const {
     return id == other.id;
 }
+inline IndexSpace LogicalRegion::get_index_space() const {
+    return Context::logical_regions.at(id).index_space;
+}
 template <unsigned int DIM>
 LogicalRegionT<DIM>::LogicalRegionT(const LogicalRegion& rhs)
     : LogicalRegion(rhs.id) {}
-inline LogicalPartition::LogicalPartition(LogicalRegion _region)
-    : region(_region) {}
+inline LogicalPartition::LogicalPartition(LogicalRegion _region,
+                                          IndexPartition _index_partition)
+    : region(_region), index_partition(_index_partition) {}
 
 inline RegionRequirement::RegionRequirement(LogicalRegion _handle,
                                             PrivilegeMode _priv,
@@ -166,23 +384,172 @@ FieldAccessor<MODE, FT, N>::FieldAccessor(const PhysicalRegion& region,
     : store(region), field(fid) {}
 template <PrivilegeMode MODE, typename FT, int N>
 FT& FieldAccessor<MODE, FT, N>::operator[](const Point<N>& p) const {
-    Domain dom = Context::logical_regions.at(store.id).index_space.dom;
-    size_t index = 0;
-    size_t dim_prod = 1;
-    for (unsigned int dim = 0; dim < p.coords.size(); dim++) {
-        index += p[dim] * dim_prod;
-        dim_prod *= dom.hi[dim] - dom.lo[dim] + 1;
-    }
+    RegionID root = Context::logical_regions.at(store.id).root;
+    const Domain& dom = Context::logical_regions.at(root).index_space.dom;
+    return at_index(root, dom.index_of(p));
+}
+template <PrivilegeMode MODE, typename FT, int N>
+template <typename T>
+FT& FieldAccessor<MODE, FT, N>::operator[](
+    const PointInDomainIterator<N, T>& it) const {
+    RegionID root = Context::logical_regions.at(store.id).root;
+    const Domain& dom = Context::logical_regions.at(root).index_space.dom;
+    const Domain& walked = *it.dom;
+    bool same = walked.dense()
+                    ? dom.dense() && walked.lo == dom.lo && walked.hi == dom.hi
+                    : walked.sparsity == dom.sparsity;
+    return at_index(root, same ? it.index : dom.index_of(it.p));
+}
+template <PrivilegeMode MODE, typename FT, int N>
+FT& FieldAccessor<MODE, FT, N>::at_index(RegionID root, size_t index) const {
     uint8_t* base = static_cast<uint8_t*>(
-        Context::physical_regions.at(store.id).fields.at(field));
+        Context::physical_regions.at(root).fields.at(field));
     FieldSpaceID fsid = Context::logical_regions.at(store.id).field_space.id;
     size_t fsize = Context::field_spaces.at(fsid).field_sizes.at(field);
     return *(FT*)(base + index * fsize);
 }
 
 inline impl::LogicalRegionImpl::LogicalRegionImpl(IndexSpace ispace,
-                                                  FieldSpace fspace)
-    : index_space(ispace), field_space(fspace) {}
+                                                  FieldSpace fspace,
+                                                  RegionID _root)
+    : index_space(ispace), field_space(fspace), root(_root) {}
+
+inline size_t impl::SparsityMapImpl::num_runs() const {
+    return runs.size() / (dim + 1);
+}
+inline const coord_t* impl::SparsityMapImpl::run(size_t r) const {
+    return runs.data() + r * (dim + 1);
+}
+
+inline void impl::append_point(std::vector<coord_t>& runs, unsigned int dim,
+                               const DomainPoint& p) {
+    if (p.coords.size() != dim) {
+        throw std::logic_error("points must have the same dimension");
+    }
+    runs.insert(runs.end(), p.coords.begin(), p.coords.end());
+    runs.push_back(p[0]);
+}
+// Appends the rows of a domain as runs along dimension 0. Empty domains
+// are skipped whatever their dimension.
+inline void impl::append_runs(std::vector<coord_t>& runs, unsigned int dim,
+                              const Domain& dom) {
+    if (!dom.dense()) {
+        if (dom.size() == 0) {
+            return;
+        }
+        if (dom.sparsity->dim != dim) {
+            throw std::logic_error("domains must have the same dimension");
+        }
+        runs.insert(runs.end(), dom.sparsity->runs.begin(),
+                    dom.sparsity->runs.end());
+        return;
+    }
+    for (unsigned int d = 0; d < dom.get_dim(); d++) {
+        if (dom.hi[d] < dom.lo[d]) {
+            return;
+        }
+    }
+    if (dom.get_dim() != dim || dom.hi.coords.size() != dim) {
+        throw std::logic_error("domains must have the same dimension");
+    }
+    if (dim == 0) {
+        return;
+    }
+    DomainPoint row = dom.lo;
+    while (true) {
+        runs.insert(runs.end(), row.coords.begin(), row.coords.end());
+        runs.push_back(dom.hi[0]);
+        unsigned int d = 1;
+        for (; d < dim; d++) {
+            if (row[d] == dom.hi[d]) {
+                row[d] = dom.lo[d];
+            } else {
+                row[d]++;
+                break;
+            }
+        }
+        if (d == dim) {
+            return;
+        }
+    }
+}
+// Builds a domain from runs along dimension 0, which may be unsorted and
+// overlapping.
+inline Domain impl::make_sparse_domain(unsigned int dim,
+                                       std::vector<coord_t> runs) {
+    size_t stride = dim + 1;
+    std::vector<size_t> order(runs.size() / stride);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        const coord_t* ra = runs.data() + a * stride;
+        const coord_t* rb = runs.data() + b * stride;
+        for (unsigned int d = dim; d-- > 1;) {
+            if (ra[d] != rb[d]) {
+                return ra[d] < rb[d];
+            }
+        }
+        return ra[0] < rb[0];
+    });
+    auto sparsity = std::make_shared<SparsityMapImpl>();
+    sparsity->dim = dim;
+    std::vector<coord_t>& merged = sparsity->runs;
+    for (size_t r : order) {
+        const coord_t* run = runs.data() + r * stride;
+        size_t n = merged.size();
+        if (n > 0 && std::equal(run + 1, run + dim, &merged[n - dim]) &&
+            run[0] <= merged[n - 1] + 1) {
+            merged[n - 1] = std::max(merged[n - 1], run[dim]);
+        } else {
+            merged.insert(merged.end(), run, run + stride);
+        }
+    }
+    Domain dom;
+    sparsity->offsets.push_back(0);
+    for (size_t r = 0; r < sparsity->num_runs(); r++) {
+        const coord_t* run = sparsity->run(r);
+        sparsity->offsets.push_back(sparsity->offsets.back() + run[dim] -
+                                    run[0] + 1);
+        if (r == 0) {
+            dom.lo.coords.assign(run, run + dim);
+            dom.hi = dom.lo;
+        }
+        for (unsigned int d = 0; d < dim; d++) {
+            dom.lo[d] = std::min(dom.lo[d], run[d]);
+            dom.hi[d] = std::max(dom.hi[d], d == 0 ? run[dim] : run[d]);
+        }
+    }
+    // Keep the cheaper dense representation if every point is valid, which
+    // has the same storage order.
+    if (!merged.empty() && dom.size() == sparsity->offsets.back()) {
+        return dom;
+    }
+    dom.sparsity = sparsity;
+    return dom;
+}
+inline size_t impl::field_size(LogicalRegion region, FieldID fid) {
+    FieldSpaceID fsid = Context::logical_regions.at(region.id).field_space.id;
+    return Context::field_spaces.at(fsid).field_sizes.at(fid);
+}
+inline void* impl::field_ptr(LogicalRegion region, FieldID fid,
+                             const DomainPoint& p) {
+    RegionID root = Context::logical_regions.at(region.id).root;
+    const Domain& dom = Context::logical_regions.at(root).index_space.dom;
+    uint8_t* base = static_cast<uint8_t*>(
+        Context::physical_regions.at(root).fields.at(fid));
+    return base + dom.index_of(p) * field_size(region, fid);
+}
+// Reads a point-valued field, stored as one coord_t per dimension.
+inline DomainPoint impl::read_point_field(LogicalRegion region, FieldID fid,
+                                          const DomainPoint& p) {
+    size_t fsize = field_size(region, fid);
+    if (fsize == 0 || fsize % sizeof(coord_t) != 0) {
+        throw std::logic_error("partition field must hold coord_t values");
+    }
+    const coord_t* val = (const coord_t*)field_ptr(region, fid, p);
+    DomainPoint res;
+    res.coords.assign(val, val + fsize / sizeof(coord_t));
+    return res;
+}
 
 /* Runtime types and classes. */
 
@@ -190,10 +557,18 @@ inline Future::Future(void* _res) : res(_res) {}
 inline void Future::get_void_result() const {}
 template <typename T>
 T Future::get_result() const {
+    if (res == nullptr) {
+        throw std::logic_error("future has no result");
+    }
     return *(T*)res;
 }
 inline bool Future::is_ready() const { return true; }
 
+inline Predicate::Predicate() : value(true) {}
+inline Predicate::Predicate(bool _value) : value(_value) {}
+inline const Predicate Predicate::TRUE_PRED(true);
+inline const Predicate Predicate::FALSE_PRED(false);
+
 inline ProcessorConstraint::ProcessorConstraint(Processor::Kind kind) {}
 
 inline TaskArgument::TaskArgument(const void* arg, size_t argsize)
@@ -203,8 +578,12 @@ inline Task::Task(TaskArgument ta) {
     memcpy(args, ta._arg, ta._argsize);
 }
 inline Task::~Task() { std::free(args); }
-inline TaskLauncher::TaskLauncher(TaskID tid, TaskArgument arg)
-    : _tid(tid), _arg(arg) {}
+inline TaskLauncher::TaskLauncher(TaskID tid, TaskArgument arg,
+                                  Predicate pred)
+    : _tid(tid),
+      _arg(arg),
+      predicate(pred),
+      predicate_false_result(nullptr, 0) {}
 inline RegionRequirement& TaskLauncher::add_region_requirement(
     const RegionRequirement& req) {
     reqs.push_back(req);
@@ -225,6 +604,25 @@ inline TaskVariantRegistrar& TaskVariantRegistrar::add_constraint(
 inline InlineLauncher::InlineLauncher(const RegionRequirement& req)
     : _req(req) {}
 
+inline CopyLauncher::CopyLauncher(Predicate pred) : predicate(pred) {}
+inline unsigned int CopyLauncher::add_copy_requirements(
+    const RegionRequirement& src, const RegionRequirement& dst) {
+    src_requirements.push_back(src);
+    dst_requirements.push_back(dst);
+    return src_requirements.size() - 1;
+}
+inline void CopyLauncher::add_src_field(unsigned int idx, FieldID fid) {
+    src_requirements.at(idx).add_field(fid);
+}
+inline void CopyLauncher::add_dst_field(unsigned int idx, FieldID fid) {
+    dst_requirements.at(idx).add_field(fid);
+}
+
+inline FillLauncher::FillLauncher(LogicalRegion _handle, LogicalRegion parent,
+                                  TaskArgument arg, Predicate pred)
+    : handle(_handle), argument(arg), predicate(pred) {}
+inline void FillLauncher::add_field(FieldID fid) { fields.push_back(fid); }
+
 inline InputArgs Runtime::get_input_args() { return input_args; }
 inline void Runtime::set_top_level_task_id(TaskID top_id) {
     top_level_task_id = top_id;
@@ -255,13 +653,142 @@ inline IndexSpace Runtime::create_index_space(Context ctx,
                                               const Domain& bounds) {
     return IndexSpace(bounds);
 }
+inline IndexSpace Runtime::create_index_space(
+    Context ctx, const std::vector<DomainPoint>& points) {
+    unsigned int dim = points.empty() ? 0 : points.front().coords.size();
+    std::vector<coord_t> runs;
+    for (const DomainPoint& p : points) {
+        impl::append_point(runs, dim, p);
+    }
+    return IndexSpace(impl::make_sparse_domain(dim, std::move(runs)));
+}
+inline IndexSpace Runtime::create_index_space(
+    Context ctx, const std::vector<Domain>& rects) {
+    unsigned int dim = rects.empty() ? 0 : rects.front().get_dim();
+    std::vector<coord_t> runs;
+    for (const Domain& rect : rects) {
+        impl::append_runs(runs, dim, rect);
+    }
+    return IndexSpace(impl::make_sparse_domain(dim, std::move(runs)));
+}
 inline void Runtime::destroy_index_space(Context ctx, IndexSpace handle) {
     return;
 }
+inline Domain Runtime::get_index_space_domain(IndexSpace handle) {
+    return handle.dom;
+}
 inline IndexPartition Runtime::create_equal_partition(Context ctx,
                                                       IndexSpace parent,
                                                       IndexSpace color_space) {
-    return IndexPartition();
+    // The parent is not split, every subspace aliases it.
+    impl::IndexPartitionImpl part;
+    for (Domain::DomainPointIterator c(color_space.dom); c; c.step()) {
+        part.subspaces.emplace(*c, parent);
+    }
+    Context::index_partitions.push_back(std::move(part));
+    return IndexPartition(Context::index_partitions.size() - 1);
+}
+inline IndexPartition Runtime::create_partition_by_field(
+    Context ctx, LogicalRegion handle, LogicalRegion parent, FieldID fid,
+    IndexSpace color_space) {
+    std::map<DomainPoint, std::vector<coord_t>> colored;
+    for (Domain::DomainPointIterator c(color_space.dom); c; c.step()) {
+        colored[*c];
+    }
+    const Domain& dom = handle.get_index_space().dom;
+    for (Domain::DomainPointIterator p(dom); p; p.step()) {
+        auto it = colored.find(impl::read_point_field(handle, fid, *p));
+        if (it != colored.end()) {
+            impl::append_point(it->second, dom.get_dim(), *p);
+        }
+    }
+    impl::IndexPartitionImpl part;
+    for (auto& color : colored) {
+        part.subspaces.emplace(color.first,
+                               IndexSpace(impl::make_sparse_domain(
+                                   dom.get_dim(), std::move(color.second))));
+    }
+    Context::index_partitions.push_back(std::move(part));
+    return IndexPartition(Context::index_partitions.size() - 1);
+}
+inline IndexPartition Runtime::create_partition_by_image(
+    Context ctx, IndexSpace handle, LogicalPartition projection,
+    LogicalRegion parent, FieldID fid, IndexSpace color_space) {
+    impl::IndexPartitionImpl part;
+    for (Domain::DomainPointIterator c(color_space.dom); c; c.step()) {
+        LogicalRegion src = get_logical_subregion_by_color(projection, *c);
+        std::vector<coord_t> runs;
+        for (Domain::DomainPointIterator p(src.get_index_space().dom); p;
+             p.step()) {
+            DomainPoint q = impl::read_point_field(src, fid, *p);
+            if (handle.dom.contains(q)) {
+                impl::append_point(runs, handle.dom.get_dim(), q);
+            }
+        }
+        part.subspaces.emplace(*c, IndexSpace(impl::make_sparse_domain(
+                                       handle.dom.get_dim(), std::move(runs))));
+    }
+    Context::index_partitions.push_back(std::move(part));
+    return IndexPartition(Context::index_partitions.size() - 1);
+}
+inline IndexPartition Runtime::create_partition_by_preimage(
+    Context ctx, IndexPartition projection, LogicalRegion handle,
+    LogicalRegion parent, FieldID fid, IndexSpace color_space) {
+    const impl::IndexPartitionImpl& proj =
+        Context::index_partitions.at(projection.id);
+    std::vector<std::pair<DomainPoint, std::vector<coord_t>>> colored;
+    std::vector<const Domain*> targets;
+    unsigned int target_dim = 0;
+    for (Domain::DomainPointIterator c(color_space.dom); c; c.step()) {
+        colored.emplace_back(*c, std::vector<coord_t>());
+        targets.push_back(&proj.subspaces.at(*c).dom);
+        if (targets.back()->size() > 0) {
+            target_dim = targets.back()->get_dim();
+        }
+    }
+    // Invert the projection: list the colors of each point of the union of
+    // its subspaces, indexed by storage position in the union.
+    std::vector<coord_t> runs;
+    for (const Domain* target : targets) {
+        impl::append_runs(runs, target_dim, *target);
+    }
+    Domain all = impl::make_sparse_domain(target_dim, std::move(runs));
+    std::vector<size_t> starts(all.size() + 1, 0);
+    for (const Domain* target : targets) {
+        for (Domain::DomainPointIterator q(*target); q; q.step()) {
+            starts[all.index_of(*q) + 1]++;
+        }
+    }
+    std::partial_sum(starts.begin(), starts.end(), starts.begin());
+    std::vector<size_t> colors(starts.back());
+    std::vector<size_t> next(starts.begin(), starts.end() - 1);
+    for (size_t k = 0; k < targets.size(); k++) {
+        for (Domain::DomainPointIterator q(*targets[k]); q; q.step()) {
+            colors[next[all.index_of(*q)]++] = k;
+        }
+    }
+    const Domain& dom = handle.get_index_space().dom;
+    for (Domain::DomainPointIterator p(dom); p; p.step()) {
+        size_t index;
+        if (!all.find(impl::read_point_field(handle, fid, *p), index)) {
+            continue;
+        }
+        for (size_t j = starts[index]; j < starts[index + 1]; j++) {
+            impl::append_point(colored[colors[j]].second, dom.get_dim(), *p);
+        }
+    }
+    impl::IndexPartitionImpl part;
+    for (auto& color : colored) {
+        part.subspaces.emplace(color.first,
+                               IndexSpace(impl::make_sparse_domain(
+                                   dom.get_dim(), std::move(color.second))));
+    }
+    Context::index_partitions.push_back(std::move(part));
+    return IndexPartition(Context::index_partitions.size() - 1);
+}
+inline IndexSpace Runtime::get_index_subspace(IndexPartition p,
+                                              const DomainPoint& color) {
+    return Context::index_partitions.at(p.id).subspaces.at(color);
 }
 inline FieldSpace Runtime::create_field_space(Context ctx) {
     Context::field_spaces.emplace_back();
@@ -278,7 +805,8 @@ inline LogicalRegion Runtime::create_logical_region(Context ctx,
                                                     IndexSpace index,
                                                     FieldSpace fields) {
     RegionID id = Context::logical_regions.size();
-    Context::logical_regions.push_back(impl::LogicalRegionImpl(index, fields));
+    Context::logical_regions.push_back(
+        impl::LogicalRegionImpl(index, fields, id));
     // Allocate storage space.
     Context::physical_regions.emplace_back();
     for (auto field : Context::field_spaces.at(fields.id).field_sizes) {
@@ -299,14 +827,47 @@ inline PhysicalRegion Runtime::map_region(Context ctx,
 inline void Runtime::unmap_region(Context ctx, PhysicalRegion region) {}
 inline LogicalPartition Runtime::get_logical_partition(LogicalRegion parent,
                                                        IndexPartition handle) {
-    return LogicalPartition(parent);
+    return LogicalPartition(parent, handle);
 }
 inline LogicalRegion Runtime::get_logical_subregion_by_color(
     LogicalPartition parent, const DomainPoint& c) {
-    return parent.region;
+    impl::IndexPartitionImpl& part =
+        Context::index_partitions.at(parent.index_partition.id);
+    IndexSpace subspace = part.subspaces.at(c);
+    impl::LogicalRegionImpl region =
+        Context::logical_regions.at(parent.region.id);
+    if (subspace == region.index_space) {
+        return parent.region;
+    }
+    auto key = std::make_pair(parent.region.id, c);
+    auto it = part.subregions.find(key);
+    if (it != part.subregions.end()) {
+        return LogicalRegion(it->second);
+    }
+    // Subregions share the storage of their root region.
+    RegionID id = Context::logical_regions.size();
+    Context::logical_regions.push_back(
+        impl::LogicalRegionImpl(subspace, region.field_space, region.root));
+    Context::physical_regions.emplace_back();
+    part.subregions.emplace(key, id);
+    return LogicalRegion(id);
 }
 inline Future Runtime::execute_task(Context ctx,
                                     const TaskLauncher& launcher) {
+    // Elide the launch before copying arguments or setting up regions.
+    if (!launcher.predicate.value) {
+        if (launcher.predicate_false_future.res != nullptr) {
+            return launcher.predicate_false_future;
+        }
+        const TaskArgument& res = launcher.predicate_false_result;
+        if (res._argsize == 0) {
+            return Future();
+        }
+        Future fut(std::malloc(res._argsize));
+        memcpy(fut.res, res._arg, res._argsize);
+        futures.push_back(fut);
+        return fut;
+    }
     Task task(launcher._arg);
     std::vector<PhysicalRegion> regions;
     for (auto req : launcher.reqs) {
@@ -316,6 +877,91 @@ inline Future Runtime::execute_task(Context ctx,
     futures.push_back(fut);
     return fut;
 }
+inline void Runtime::issue_copy_operation(Context ctx,
+                                          const CopyLauncher& launcher) {
+    if (!launcher.predicate.value) {
+        return;
+    }
+    // Check every field pair before copying anything.
+    if (launcher.src_requirements.size() != launcher.dst_requirements.size()) {
+        throw std::logic_error("copy requirements must come in pairs");
+    }
+    for (size_t i = 0; i < launcher.src_requirements.size(); i++) {
+        const RegionRequirement& src = launcher.src_requirements.at(i);
+        const RegionRequirement& dst = launcher.dst_requirements.at(i);
+        if (src.field_ids.size() != dst.field_ids.size()) {
+            throw std::logic_error("copy must have as many src as dst fields");
+        }
+        for (size_t j = 0; j < src.field_ids.size(); j++) {
+            if (impl::field_size(src.region, src.field_ids.at(j)) !=
+                impl::field_size(dst.region, dst.field_ids.at(j))) {
+                throw std::logic_error("copied fields must have equal sizes");
+            }
+        }
+    }
+    for (size_t i = 0; i < launcher.src_requirements.size(); i++) {
+        const RegionRequirement& src = launcher.src_requirements.at(i);
+        const RegionRequirement& dst = launcher.dst_requirements.at(i);
+        // Only points in both index spaces are copied.
+        const Domain& dom = src.region.get_index_space().dom;
+        const Domain& dst_dom = dst.region.get_index_space().dom;
+        bool same_root = Context::logical_regions.at(src.region.id).root ==
+                         Context::logical_regions.at(dst.region.id).root;
+        for (size_t j = 0; j < src.field_ids.size(); j++) {
+            FieldID src_fid = src.field_ids.at(j);
+            FieldID dst_fid = dst.field_ids.at(j);
+            if (same_root && src_fid == dst_fid) {
+                // Every point would be copied onto itself.
+                continue;
+            }
+            size_t fsize = impl::field_size(src.region, src_fid);
+            for (Domain::DomainPointIterator p(dom); p; p.step()) {
+                if (dst_dom.contains(*p)) {
+                    memcpy(impl::field_ptr(dst.region, dst_fid, *p),
+                           impl::field_ptr(src.region, src_fid, *p), fsize);
+                }
+            }
+        }
+    }
+}
+inline void Runtime::fill_fields(Context ctx, const FillLauncher& launcher) {
+    if (!launcher.predicate.value) {
+        return;
+    }
+    for (FieldID fid : launcher.fields) {
+        if (impl::field_size(launcher.handle, fid) !=
+            launcher.argument._argsize) {
+            throw std::logic_error("fill value size must match field size");
+        }
+    }
+    const Domain& dom = launcher.handle.get_index_space().dom;
+    for (FieldID fid : launcher.fields) {
+        for (Domain::DomainPointIterator p(dom); p; p.step()) {
+            memcpy(impl::field_ptr(launcher.handle, fid, *p),
+                   launcher.argument._arg, launcher.argument._argsize);
+        }
+    }
+}
+inline Predicate Runtime::create_predicate(Context ctx, const Future& f) {
+    return Predicate(f.get_result<bool>());
+}
+inline Predicate Runtime::predicate_not(Context ctx, const Predicate& p) {
+    return Predicate(!p.value);
+}
+inline Predicate Runtime::predicate_and(Context ctx, const Predicate& p1,
+                                        const Predicate& p2) {
+    return Predicate(p1.value && p2.value);
+}
+inline Predicate Runtime::predicate_or(Context ctx, const Predicate& p1,
+                                       const Predicate& p2) {
+    return Predicate(p1.value || p2.value);
+}
+inline Future Runtime::get_predicate_future(Context ctx, const Predicate& p) {
+    Future fut(std::malloc(sizeof(bool)));
+    *(bool*)fut.res = p.value;
+    futures.push_back(fut);
+    return fut;
+}
 template <typename T,
           T (*TASK_PTR)(const Task*, const std::vector<PhysicalRegion>&,
                         Context, Runtime*)>